@@ -15,6 +15,7 @@ struct EntryInfo {
 
 std::vector<EntryInfo> get_directory_entries(const std::filesystem::path& path = ".", int depth = 0);
 std::string human_readable_size(std::uintmax_t bytes);
+std::uintmax_t get_directory_size(const std::filesystem::path& dir_path);
 std::set<std::filesystem::path>& get_expanded_dirs();
 void build_tree_entries(const std::filesystem::path& path, 
                         const std::set<std::filesystem::path>& expanded_dirs,
@@ -24,4 +25,10 @@ void build_tree_entries(const std::filesystem::path& path,
 
 void clear_dir_size_cache();
 void clear_tree_entries_cache();
-void expand_resto(const std::filesystem::path& path);
\ No newline at end of file
+void expand_resto(const std::filesystem::path& path);
+// Presupuesto de memoria (bytes) para la caché de tamaños; 0 = sin límite
+void set_memory_cap(std::uintmax_t bytes);
+std::uintmax_t get_cache_memory();
+// true si un error de E/S desactivó el volcado a disco
+bool spill_disabled();
+std::uintmax_t parse_size(const std::string& text);
\ No newline at end of file
@@ -6,6 +6,11 @@
 #include <map>
 #include <unordered_map>
 #include <mutex>
+#include <cstdio>
+#include <cstdint>
+#include <stdexcept>
+#include <cctype>
+#include <vector>
 
 std::string human_readable_size(std::uintmax_t bytes) {
     const char* sizes[] = {"bytes", "KB", "MB", "GB", "TB"};
@@ -23,9 +28,405 @@ std::string human_readable_size(std::uintmax_t bytes) {
 std::unordered_map<std::filesystem::path, std::uintmax_t> dir_size_cache;
 std::mutex cache_mutex;
 
+// Modo de memoria acotada. memory_cap = 0 desactiva el límite y se usa
+// dir_size_cache tal cual. Con límite, bounded_cache solo guarda totales de
+// directorios (la UI lee el tamaño de los archivos del propio listado) y está
+// ordenada por ruta: el detalle de un directorio queda contiguo tras él
+static std::uintmax_t memory_cap = 0;
+static std::map<std::filesystem::path, std::uintmax_t> bounded_cache;
+static std::uintmax_t cache_bytes = 0; // memoria reservada por la caché y los índices
+
+// Segmento del fichero temporal con los totales de los subdirectorios directos
+// de un directorio colapsado. count = 0 indica que no hay segmento
+struct SpillSegment {
+    std::uint64_t offset;
+    std::uint64_t count;
+};
+// Directorio colapsado devuelto a memoria; stamp ordena por último uso
+struct RestoredDir {
+    SpillSegment seg;
+    std::uint64_t stamp;
+};
+static std::map<std::filesystem::path, SpillSegment> spill_index; // dir colapsado -> segmento
+static std::map<std::filesystem::path, RestoredDir> restored_dirs;
+static std::map<std::uint64_t, std::filesystem::path> restore_lru; // stamp -> dir, el más antiguo primero
+static std::uint64_t restore_clock = 0;
+static std::FILE* spill_file = nullptr;
+static std::uint64_t spill_end = 0;  // tamaño escrito del fichero temporal
+static bool spill_at_end = true;     // false tras leer: hay que volver al final
+static bool spill_failed = false;    // tras un error de E/S no se vuelca más
+
+void set_memory_cap(std::uintmax_t bytes) {
+    std::lock_guard<std::mutex> lock(cache_mutex);
+    memory_cap = bytes;
+}
+
+bool spill_disabled() {
+    std::lock_guard<std::mutex> lock(cache_mutex);
+    return spill_failed;
+}
+
+std::uintmax_t get_cache_memory() {
+    std::lock_guard<std::mutex> lock(cache_mutex);
+    return cache_bytes;
+}
+
+std::uintmax_t parse_size(const std::string& text) {
+    // std::stoull acepta signo negativo y lo convierte en un valor enorme
+    if (text.empty() || !std::isdigit(static_cast<unsigned char>(text[0])))
+        throw std::invalid_argument("tamaño no válido: " + text);
+    std::size_t pos = 0;
+    std::uintmax_t value = std::stoull(text, &pos);
+    std::string suffix = text.substr(pos);
+    std::transform(suffix.begin(), suffix.end(), suffix.begin(),
+                   [](unsigned char c) { return std::toupper(c); });
+    int shift;
+    if (suffix.empty() || suffix == "B") shift = 0;
+    else if (suffix == "K" || suffix == "KB") shift = 10;
+    else if (suffix == "M" || suffix == "MB") shift = 20;
+    else if (suffix == "G" || suffix == "GB") shift = 30;
+    else throw std::invalid_argument("sufijo de tamaño no válido: " + suffix);
+    if (value > (UINTMAX_MAX >> shift)) throw std::out_of_range("tamaño demasiado grande: " + text);
+    return value << shift;
+}
+
+// Bloque que reserva malloc de glibc para n bytes (cabecera de 8, múltiplos de 16)
+static std::uintmax_t heap_block(std::uintmax_t n) {
+    return std::max<std::uintmax_t>(32, (n + 8 + 15) & ~std::uintmax_t(15));
+}
+
+// Memoria de un nodo de std::map con clave path: el nodo, la cadena si no cabe
+// en el buffer interno (15) y, con varios componentes, la lista de libstdc++
+// (cabecera de 8 y 48 bytes por componente) más las cadenas largas de cada uno.
+// Estimación fija, contrastada una vez con mallinfo2 para glibc y libstdc++
+// con rutas construidas desde una cadena; no se mide en ejecución
+static std::uintmax_t estimate_entry_bytes(const std::filesystem::path& p, std::size_t value_size) {
+    std::uintmax_t bytes = heap_block(32 + sizeof(std::filesystem::path) + value_size);
+    if (p.native().size() > 15) bytes += heap_block(p.native().size() + 1);
+    std::uintmax_t components = std::distance(p.begin(), p.end());
+    if (components > 1) {
+        bytes += heap_block(8 + 48 * components);
+        for (const auto& c : p)
+            if (c.native().size() > 15) bytes += heap_block(c.native().size() + 1);
+    }
+    return bytes;
+}
+
+static std::uintmax_t cache_entry_bytes(const std::filesystem::path& p) {
+    return estimate_entry_bytes(p, sizeof(std::uintmax_t));
+}
+static std::uintmax_t index_entry_bytes(const std::filesystem::path& p) {
+    return estimate_entry_bytes(p, sizeof(SpillSegment));
+}
+// Entrada en restored_dirs más su copia en restore_lru (mismo nodo que valor de 8 bytes)
+static std::uintmax_t restored_entry_bytes(const std::filesystem::path& p) {
+    return estimate_entry_bytes(p, sizeof(RestoredDir)) + estimate_entry_bytes(p, sizeof(std::uint64_t));
+}
+
+// Las siguientes funciones asumen cache_mutex bloqueado.
+// Devuelve la memoria añadida (0 si la ruta ya estaba)
+static std::uintmax_t cache_insert(const std::filesystem::path& p, std::uintmax_t size) {
+    auto it = bounded_cache.find(p);
+    if (it != bounded_cache.end()) {
+        it->second = size;
+        return 0;
+    }
+    // Copia desde la cadena para que la lista de componentes no tenga holgura
+    it = bounded_cache.emplace(std::filesystem::path(p.native()), size).first;
+    std::uintmax_t bytes = cache_entry_bytes(it->first);
+    cache_bytes += bytes;
+    return bytes;
+}
+
+static void index_insert(const std::filesystem::path& p, SpillSegment seg) {
+    auto [it, inserted] = spill_index.insert_or_assign(std::filesystem::path(p.native()), seg);
+    if (inserted) cache_bytes += index_entry_bytes(it->first);
+}
+
+static bool is_inside(const std::filesystem::path& p, const std::filesystem::path& dir) {
+    auto [d, q] = std::mismatch(dir.begin(), dir.end(), p.begin(), p.end());
+    return d == dir.end() && q != p.end();
+}
+
+static std::filesystem::path child_path(const std::filesystem::path& dir, const std::string& name) {
+    std::string s = dir.native();
+    if (!s.empty() && s.back() != '/') s += '/';
+    return std::filesystem::path(s + name);
+}
+
+// Borra las entradas estrictamente por debajo de dir en un índice ordenado
+template <typename Map, typename Bytes>
+static void erase_below(Map& m, const std::filesystem::path& dir, Bytes bytes) {
+    auto first = m.upper_bound(dir);
+    auto last = first;
+    while (last != m.end() && is_inside(last->first, dir)) {
+        cache_bytes -= bytes(last->first);
+        ++last;
+    }
+    m.erase(first, last);
+}
+
+static void forget_restored(std::map<std::filesystem::path, RestoredDir>::iterator it) {
+    cache_bytes -= restored_entry_bytes(it->first);
+    restore_lru.erase(it->second.stamp);
+    restored_dirs.erase(it);
+}
+
+static void forget_restored_below(const std::filesystem::path& dir) {
+    auto it = restored_dirs.upper_bound(dir);
+    while (it != restored_dirs.end() && is_inside(it->first, dir)) forget_restored(it++);
+}
+
+// Registro de un subdirectorio: total, segmento propio y nombre
+struct SpillRecord {
+    std::string name;
+    std::uintmax_t size;
+    SpillSegment seg;
+};
+
+// Añade los registros al final del fichero temporal. Sin fflush por registro:
+// collapse_subtree vacía el buffer una vez por colapso
+static bool write_segment(const std::vector<SpillRecord>& records, SpillSegment& seg) {
+    if (spill_failed) return false;
+    if (!spill_file) {
+        spill_file = std::tmpfile();
+        spill_end = 0;
+        spill_at_end = true;
+        if (!spill_file) {
+            spill_failed = true;
+            return false;
+        }
+    }
+    if (!spill_at_end) {
+        if (fseeko(spill_file, (off_t)spill_end, SEEK_SET) != 0) {
+            spill_failed = true;
+            return false;
+        }
+        spill_at_end = true;
+    }
+    seg = {spill_end, records.size()};
+    for (const auto& r : records) {
+        std::uint64_t header[4] = {r.size, r.seg.offset, r.seg.count, r.name.size()};
+        if (std::fwrite(header, sizeof(header), 1, spill_file) != 1 ||
+            std::fwrite(r.name.data(), 1, r.name.size(), spill_file) != r.name.size()) {
+            spill_failed = true;
+            return false;
+        }
+        spill_end += sizeof(header) + r.name.size();
+    }
+    return true;
+}
+
+static bool read_record(SpillRecord& r) {
+    std::uint64_t header[4];
+    if (std::fread(header, sizeof(header), 1, spill_file) != 1) return false;
+    r.size = header[0];
+    r.seg = {header[1], header[2]};
+    r.name.assign(header[3], '\0');
+    return std::fread(r.name.data(), 1, r.name.size(), spill_file) == r.name.size();
+}
+
+// Umbral para colapsar: evita segmentos diminutos que apenas liberan memoria
+static std::uintmax_t min_spill_bytes() {
+    return std::max<std::uintmax_t>(memory_cap / 256, 16 * 1024);
+}
+
+// Se colapsa antes de llegar al límite: se reserva max(1/4, 1 MiB) para la
+// memoria de trabajo (registros pendientes al colapsar, buffers de opendir y
+// stdio, listados)
+static bool over_budget() {
+    if (memory_cap == 0) return false;
+    std::uintmax_t reserve = std::min(memory_cap, std::max<std::uintmax_t>(memory_cap / 4, 1 << 20));
+    return cache_bytes > memory_cap - reserve;
+}
+
+// Si se supera el límite, sustituye el detalle de un directorio ya completado
+// por su total (que sigue en la caché) y lo vuelca al fichero temporal, un
+// segmento por directorio. subtree_bytes es la memoria que ocupa su detalle;
+// devuelve la que queda tras colapsar
+static std::uintmax_t collapse_subtree(const std::filesystem::path& dir, std::uintmax_t subtree_bytes) {
+    namespace fs = std::filesystem;
+    if (!over_budget() || subtree_bytes < min_spill_bytes())
+        return subtree_bytes;
+    auto first = bounded_cache.upper_bound(dir);
+    auto last = first;
+    while (last != bounded_cache.end() && is_inside(last->first, dir)) ++last;
+    if (first == last) return subtree_bytes;
+
+    // En orden inverso cada directorio aparece después de todos sus
+    // descendientes, así que sus hijos ya están agrupados al llegar a él
+    std::map<fs::path, std::vector<SpillRecord>> pending;
+    for (auto it = last; it != first;) {
+        --it;
+        SpillRecord rec{it->first.filename().native(), it->second, {0, 0}};
+        auto seg_it = spill_index.find(it->first);
+        if (seg_it != spill_index.end()) rec.seg = seg_it->second;
+        auto children = pending.find(it->first);
+        if (children != pending.end()) {
+            if (!write_segment(children->second, rec.seg)) return subtree_bytes;
+            pending.erase(children);
+        }
+        pending[it->first.parent_path()].push_back(std::move(rec));
+    }
+    SpillSegment seg;
+    // Si no se pudo escribir todo, el detalle se queda en memoria. fwrite solo
+    // llena el buffer de stdio: el error real (p.ej. disco lleno) aparece al vaciarlo
+    if (!write_segment(pending[dir], seg)) return subtree_bytes;
+    if (std::fflush(spill_file) != 0 || std::ferror(spill_file)) {
+        spill_failed = true;
+        return subtree_bytes;
+    }
+
+    for (auto it = first; it != last; ++it) cache_bytes -= cache_entry_bytes(it->first);
+    bounded_cache.erase(first, last);
+    erase_below(spill_index, dir, index_entry_bytes);
+    forget_restored_below(dir);
+    index_insert(dir, seg);
+    return index_entry_bytes(dir);
+}
+
+// Devuelve un directorio restaurado a su segmento original, que sigue siendo
+// válido: contiene los totales de sus hijos y los segmentos de los nietos
+static void evict_restored(std::map<std::filesystem::path, RestoredDir>::iterator r) {
+    std::filesystem::path dir = r->first;
+    SpillSegment seg = r->second.seg;
+    erase_below(bounded_cache, dir, cache_entry_bytes);
+    erase_below(spill_index, dir, index_entry_bytes);
+    forget_restored_below(dir);
+    forget_restored(r);
+    index_insert(dir, seg);
+}
+
+// Vuelve a cargar en la caché los totales de los hijos de un directorio
+// colapsado. Si la lectura falla, las rutas ausentes se recalculan desde el disco.
+// Después libera los directorios restaurados menos usados mientras se supere el
+// límite, salvo dir y sus antecesores, que se están mostrando
+static void restore_subtree(const std::filesystem::path& dir) {
+    auto r = restored_dirs.find(dir);
+    if (r != restored_dirs.end()) {
+        restore_lru.erase(r->second.stamp);
+        r->second.stamp = ++restore_clock;
+        restore_lru.emplace(r->second.stamp, r->first);
+        return;
+    }
+    auto seg_it = spill_index.find(dir);
+    if (seg_it == spill_index.end()) return;
+    SpillSegment seg = seg_it->second;
+    cache_bytes -= index_entry_bytes(dir);
+    spill_index.erase(seg_it);
+    r = restored_dirs.emplace(std::filesystem::path(dir.native()), RestoredDir{seg, ++restore_clock}).first;
+    restore_lru.emplace(r->second.stamp, r->first);
+    cache_bytes += restored_entry_bytes(r->first);
+
+    // Un fallo de lectura desactiva el volcado: lo que no se lea se recalcula
+    spill_at_end = false;
+    if (fseeko(spill_file, (off_t)seg.offset, SEEK_SET) != 0) {
+        spill_failed = true;
+    } else {
+        SpillRecord rec;
+        for (std::uint64_t i = 0; i < seg.count; ++i) {
+            if (!read_record(rec)) {
+                spill_failed = true;
+                break;
+            }
+            std::filesystem::path child = child_path(dir, rec.name);
+            cache_insert(child, rec.size);
+            if (rec.seg.count > 0) index_insert(child, rec.seg);
+        }
+    }
+
+    while (over_budget()) {
+        // Se saltan dir y sus antecesores: como mucho uno por nivel
+        auto victim = restore_lru.begin();
+        while (victim != restore_lru.end() && (victim->second == dir || is_inside(dir, victim->second)))
+            ++victim;
+        if (victim == restore_lru.end()) break;
+        evict_restored(restored_dirs.find(victim->second));
+    }
+}
+
+// Directorio en curso del recorrido; la pila explícita evita desbordar la pila
+// del proceso en árboles muy profundos
+struct PendingDir {
+    std::filesystem::path path;
+    std::filesystem::directory_iterator it;
+    std::uintmax_t size = 0;
+    std::uintmax_t mem = 0; // memoria añadida a la caché por debajo de path
+};
+
+// Recorrido del modo acotado
+static std::uintmax_t scan_directory(const std::filesystem::path& root, std::uintmax_t& root_mem) {
+    namespace fs = std::filesystem;
+    std::vector<PendingDir> stack;
+    stack.push_back({root, fs::directory_iterator(root, fs::directory_options::skip_permission_denied)});
+    while (true) {
+        if (stack.back().it == fs::directory_iterator()) {
+            PendingDir done = std::move(stack.back());
+            stack.pop_back();
+            if (stack.empty()) {
+                root_mem = done.mem;
+                return done.size;
+            }
+            // Subdirectorio completado: se cachea su total y puede colapsarse
+            std::lock_guard<std::mutex> lock(cache_mutex);
+            std::uintmax_t added = cache_insert(done.path, done.size);
+            stack.back().size += done.size;
+            stack.back().mem += added + collapse_subtree(done.path, done.mem);
+            continue;
+        }
+        fs::directory_entry entry = *stack.back().it;
+        ++stack.back().it;
+        // Evitar seguir enlaces simbólicos
+        if (entry.is_symlink()) continue;
+        if (entry.is_directory()) {
+            fs::path sub_path = entry.path().lexically_normal();
+            {
+                std::lock_guard<std::mutex> lock(cache_mutex);
+                auto it = bounded_cache.find(sub_path);
+                if (it != bounded_cache.end()) {
+                    stack.back().size += it->second;
+                    continue;
+                }
+            }
+            fs::directory_iterator sub_it(sub_path, fs::directory_options::skip_permission_denied);
+            stack.push_back({std::move(sub_path), std::move(sub_it)});
+        } else if (entry.is_regular_file()) {
+            std::uintmax_t sz = entry.file_size();
+            if (sz > (1ULL << 40)) continue; // Ignora archivos >1TB
+            stack.back().size += sz;
+        }
+    }
+}
+
+static std::uintmax_t get_bounded_directory_size(const std::filesystem::path& norm_path) {
+    namespace fs = std::filesystem;
+    {
+        std::lock_guard<std::mutex> lock(cache_mutex);
+        auto it = bounded_cache.find(norm_path);
+        if (it != bounded_cache.end()) {
+            return it->second;
+        }
+    }
+    std::uintmax_t size = 0;
+    std::uintmax_t mem = 0;
+    try {
+        size = scan_directory(norm_path, mem);
+    } catch (const fs::filesystem_error& ex) {
+        // Error al recorrer (demasiados enlaces, permisos, etc.)
+        return 0;
+    }
+    {
+        std::lock_guard<std::mutex> lock(cache_mutex);
+        cache_insert(norm_path, size);
+        collapse_subtree(norm_path, mem);
+    }
+    return size;
+}
+
 std::uintmax_t get_directory_size(const std::filesystem::path& dir_path) {
     namespace fs = std::filesystem;
     fs::path norm_path = dir_path.lexically_normal();
+    if (memory_cap != 0) return get_bounded_directory_size(norm_path);
     {
         std::lock_guard<std::mutex> lock(cache_mutex);
         auto it = dir_size_cache.find(norm_path);
@@ -83,6 +484,11 @@ void build_tree_entries(const std::filesystem::path& path,
     int other_count = 0;
     std::uintmax_t other_total_size = 0;
     std::vector<EntryInfo> all_entries;
+    if (memory_cap != 0) {
+        // Al expandir un directorio colapsado se recupera su detalle del disco
+        std::lock_guard<std::mutex> lock(cache_mutex);
+        restore_subtree(path.lexically_normal());
+    }
     for (const auto& entry : fs::directory_iterator(path)) {
         if (entry.is_directory()) {
             std::uintmax_t dir_size = get_directory_size(entry.path());
@@ -101,7 +507,9 @@ void build_tree_entries(const std::filesystem::path& path,
         if (a.size != b.size) return a.size > b.size;
         return a.name < b.name;
     });
-    int page = resto_state.resto_page[path];
+    // find en lugar de operator[]: listar no debe añadir una entrada por directorio
+    auto page_it = resto_state.resto_page.find(path);
+    int page = page_it != resto_state.resto_page.end() ? page_it->second : 0;
     int start_idx = page * max_files;
     int end_idx = std::min((int)all_entries.size(), start_idx + max_files);
     // Añade los elementos de la página actual
@@ -145,4 +553,18 @@ std::set<std::filesystem::path>& get_expanded_dirs() {
 void clear_dir_size_cache() {
     std::lock_guard<std::mutex> lock(cache_mutex);
     dir_size_cache.clear();
+    bounded_cache.clear();
+    spill_index.clear();
+    restored_dirs.clear();
+    restore_lru.clear();
+    cache_bytes = 0;
+    // El fichero temporal solo crece durante una sesión de escaneo: los
+    // segmentos se reutilizan al volver a colapsar y se descartan aquí
+    if (spill_file) {
+        std::fclose(spill_file);
+        spill_file = nullptr;
+    }
+    spill_end = 0;
+    spill_at_end = true;
+    spill_failed = false;
 }
\ No newline at end of file
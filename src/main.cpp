@@ -14,7 +14,36 @@
 #include <thread>
 #include <atomic>
 
-int main() {
+int main(int argc, char* argv[]) {
+    // --mem-cap <tamaño>: presupuesto de memoria de la caché (p.ej. 512M, 2G)
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        std::string value;
+        if (arg == "--mem-cap" && i + 1 < argc) {
+            value = argv[++i];
+        } else if (arg.rfind("--mem-cap=", 0) == 0) {
+            value = arg.substr(10);
+        } else {
+            std::cerr << "Uso: " << argv[0] << " [--mem-cap <tamaño>]\n\n"
+                      << "  --mem-cap <tamaño>  presupuesto de memoria para la caché de tamaños\n"
+                      << "                      (p.ej. 512M, 2G). Al alcanzarlo, los subárboles ya\n"
+                      << "                      escaneados se vuelcan a un fichero temporal. La\n"
+                      << "                      memoria de la caché no se mide: se estima con los\n"
+                      << "                      tamaños de bloque de glibc y la estructura de\n"
+                      << "                      std::filesystem::path de libstdc++, y con otras\n"
+                      << "                      bibliotecas puede desviarse. No limita el RSS del\n"
+                      << "                      proceso, que suma su base y el listado en pantalla"
+                      << std::endl;
+            return (arg == "-h" || arg == "--help") ? 0 : 1;
+        }
+        try {
+            set_memory_cap(parse_size(value));
+        } catch (const std::exception&) {
+            std::cerr << "Tamaño no válido: " << value << std::endl;
+            return 1;
+        }
+    }
+
     initscr();
     noecho();
     cbreak();
@@ -96,6 +125,9 @@ int main() {
         mvprintw(0, 2, "Flechas: mover | E: expandir/colapsar | Espacio: abrir | q: salir");
         std::string scan_str = format_scan_time(last_scan_ms);
         mvprintw(rows-1, cols-15, "Scan: %s", scan_str.c_str());
+        if (spill_disabled()) {
+            mvprintw(rows-1, 2, "Error en el fichero temporal: volcado a disco desactivado");
+        }
         refresh();
         draw_help_box(rows, cols, show_help);
         int n = entries.size();
@@ -0,0 +1,264 @@
+// Prueba de carga del modo de memoria acotada.
+// Uso: stress <directorio> <entradas> <mem-cap> [--no-compare]
+// Genera (o reutiliza) un árbol de <entradas> archivos y directorios, lo escanea
+// con el límite indicado y comprueba que el total de cada directorio coincide
+// con la suma de su listado, y el de la raíz con el total generado. Después
+// expande a la vez una rama completa y sus hermanos, como haría la UI, y compara
+// el listado con el de una ejecución sin límite (salvo --no-compare: sin límite
+// la caché guarda todos los archivos y en árboles enormes no cabe en memoria).
+#include "file_utils.h"
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+#include <set>
+#include <chrono>
+#include <algorithm>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+
+namespace fs = std::filesystem;
+
+static const int FILES_PER_DIR = 40;
+static const int SUBDIRS_PER_DIR = 6;
+
+// RSS actual (no el pico) según /proc/self/statm
+static long current_rss_kb() {
+    long pages_total = 0, pages_resident = 0;
+    std::ifstream statm("/proc/self/statm");
+    statm >> pages_total >> pages_resident;
+    return pages_resident * (sysconf(_SC_PAGESIZE) / 1024);
+}
+
+static long peak_rss_kb() {
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_maxrss;
+}
+
+// Tamaño pseudoaleatorio y determinista; los archivos se crean dispersos
+static std::uintmax_t file_size_for(std::uint64_t n) {
+    n ^= n >> 33;
+    n *= 0xff51afd7ed558ccdULL;
+    n ^= n >> 33;
+    return n % 65536;
+}
+
+// Crea budget entradas bajo dir, en profundidad para no acumular rutas pendientes
+static void generate(const fs::path& dir, std::uint64_t budget, std::uint64_t& counter, std::uintmax_t& total) {
+    fs::create_directory(dir);
+    std::uint64_t files = std::min<std::uint64_t>(FILES_PER_DIR, budget);
+    for (std::uint64_t i = 0; i < files; ++i) {
+        std::uintmax_t sz = file_size_for(counter++);
+        std::string name = (dir / ("f" + std::to_string(i) + "_data.bin")).string();
+        int fd = open(name.c_str(), O_CREAT | O_WRONLY | O_TRUNC, 0644);
+        if (fd < 0 || ftruncate(fd, sz) != 0) throw std::runtime_error("no se pudo crear " + name);
+        close(fd);
+        total += sz;
+    }
+    budget -= files;
+    std::uint64_t subdirs = std::min<std::uint64_t>(SUBDIRS_PER_DIR, budget);
+    for (std::uint64_t i = 0; i < subdirs; ++i) {
+        // Cada subdirectorio cuenta como una entrada más
+        std::uint64_t share = budget / subdirs + (i < budget % subdirs ? 1 : 0);
+        if (share == 0) continue;
+        generate(dir / ("dir" + std::to_string(i)), share - 1, counter, total);
+    }
+}
+
+// Ejecuta fn en un proceso hijo para que su memoria no cuente en el pico de RSS
+template <typename Fn>
+static bool run_in_child(Fn fn) {
+    std::cout.flush();
+    pid_t pid = fork();
+    if (pid < 0) throw std::runtime_error("fork falló");
+    if (pid == 0) {
+        bool ok = false;
+        try {
+            ok = fn();
+        } catch (const std::exception& ex) {
+            std::cerr << ex.what() << std::endl;
+        }
+        std::cout.flush();
+        _exit(ok ? 0 : 1);
+    }
+    int status = 0;
+    waitpid(pid, &status, 0);
+    return WIFEXITED(status) && WEXITSTATUS(status) == 0;
+}
+
+static std::vector<fs::path> child_dirs(const fs::path& dir) {
+    std::vector<fs::path> dirs;
+    for (const auto& entry : fs::directory_iterator(dir)) {
+        if (entry.is_directory() && !entry.is_symlink()) dirs.push_back(entry.path());
+    }
+    std::sort(dirs.begin(), dirs.end());
+    return dirs;
+}
+
+// Cada directorio expandido debe sumar lo mismo que sus hijos listados ([RESTO] incluido)
+static bool listing_consistent(const std::vector<EntryInfo>& listing) {
+    for (std::size_t i = 0; i < listing.size(); ++i) {
+        if (listing[i].type != "[DIR] " || !listing[i].expanded) continue;
+        std::uintmax_t sum = 0;
+        for (std::size_t j = i + 1; j < listing.size() && listing[j].depth > listing[i].depth; ++j) {
+            if (listing[j].depth == listing[i].depth + 1) sum += listing[j].size;
+        }
+        if (sum != listing[i].size) {
+            std::cerr << "Total de " << listing[i].full_path << " no coincide con sus hijos" << std::endl;
+            return false;
+        }
+    }
+    return true;
+}
+
+static bool same_listing(const std::vector<EntryInfo>& a, const std::vector<EntryInfo>& b) {
+    if (a.size() != b.size()) return false;
+    for (std::size_t i = 0; i < a.size(); ++i) {
+        if (a[i].type != b[i].type || a[i].name != b[i].name ||
+            a[i].size != b[i].size || a[i].depth != b[i].depth) return false;
+    }
+    return true;
+}
+
+int main(int argc, char* argv[]) {
+    bool compare = true;
+    if (argc == 5 && std::string(argv[4]) == "--no-compare") {
+        compare = false;
+    } else if (argc != 4) {
+        std::cerr << "Uso: " << argv[0] << " <directorio> <entradas> <mem-cap> [--no-compare]" << std::endl;
+        return 2;
+    }
+    fs::path root = fs::path(argv[1]).lexically_normal();
+    std::uint64_t entries = std::stoull(argv[2]);
+    std::uintmax_t cap = parse_size(argv[3]);
+    // El marcador va junto al árbol para no contarlo en el total
+    fs::path marker = root.string() + ".stress";
+
+    // Reutiliza el árbol si ya se generó con el mismo número de entradas
+    std::uintmax_t expected = 0;
+    std::uint64_t stored_entries = 0;
+    std::ifstream in(marker);
+    if (in >> stored_entries >> expected && stored_entries == entries) {
+        std::cout << "Reutilizando árbol en " << root << std::endl;
+    } else if (fs::exists(root)) {
+        std::cerr << root << " ya existe y no es un árbol de " << entries << " entradas" << std::endl;
+        return 2;
+    } else {
+        auto t0 = std::chrono::steady_clock::now();
+        bool generated = run_in_child([&] {
+            std::uint64_t counter = 0;
+            std::uintmax_t generated_total = 0;
+            generate(root, entries, counter, generated_total);
+            std::ofstream(marker) << entries << " " << generated_total << std::endl;
+            return true;
+        });
+        std::ifstream generated_marker(marker);
+        if (!generated || !(generated_marker >> stored_entries >> expected)) {
+            std::cerr << "No se pudo generar el árbol" << std::endl;
+            return 2;
+        }
+        auto t1 = std::chrono::steady_clock::now();
+        std::cout << "Generadas " << entries << " entradas en "
+                  << std::chrono::duration<double>(t1 - t0).count() << " s" << std::endl;
+    }
+
+    set_memory_cap(cap);
+    long baseline_kb = current_rss_kb();
+    auto t0 = std::chrono::steady_clock::now();
+    std::uintmax_t total = get_directory_size(root);
+    auto t1 = std::chrono::steady_clock::now();
+    long scan_kb = peak_rss_kb();
+    std::cout << "Escaneo: " << std::chrono::duration<double>(t1 - t0).count() << " s, caché "
+              << human_readable_size(get_cache_memory()) << ", pico RSS "
+              << human_readable_size((scan_kb - baseline_kb) * 1024ULL) << " sobre la base" << std::endl;
+
+    bool ok = total == expected;
+    if (!ok) std::cerr << "Total de la raíz " << total << " != generado " << expected << std::endl;
+
+    // Expande todos los directorios como lo haría la UI
+    std::uint64_t dirs_checked = 0;
+    std::vector<fs::path> pending{root};
+    std::set<fs::path> no_expanded;
+    while (!pending.empty() && ok) {
+        fs::path dir = std::move(pending.back());
+        pending.pop_back();
+        std::vector<EntryInfo> listing;
+        build_tree_entries(dir, no_expanded, listing, 0, 100);
+        std::uintmax_t sum = 0;
+        for (const auto& e : listing) sum += e.size;
+        if (sum != get_directory_size(dir)) {
+            std::cerr << "Total de " << dir << " no coincide con su listado" << std::endl;
+            ok = false;
+        }
+        for (auto& sub : child_dirs(dir)) pending.push_back(std::move(sub));
+        ++dirs_checked;
+    }
+    auto t2 = std::chrono::steady_clock::now();
+    // Hasta aquí el proceso solo guarda la caché y un listado pequeño: el pico
+    // de RSS sobre la base debe quedar dentro del límite
+    long peak_kb = peak_rss_kb();
+    std::uintmax_t used = (peak_kb - baseline_kb) * 1024ULL;
+    std::cout << "Expansión: " << dirs_checked << " directorios en "
+              << std::chrono::duration<double>(t2 - t1).count() << " s, caché "
+              << human_readable_size(get_cache_memory()) << std::endl;
+    std::cout << "Pico RSS: " << human_readable_size(peak_kb * 1024ULL) << " (base "
+              << human_readable_size(baseline_kb * 1024ULL) << ", +" << human_readable_size(used)
+              << ", límite " << (cap ? human_readable_size(cap) : std::string("ninguno")) << ")" << std::endl;
+    if (cap != 0 && used > cap) {
+        std::cerr << "El pico de RSS supera el límite" << std::endl;
+        ok = false;
+    }
+
+    // Rama completa de la raíz a una hoja con todos los hermanos de cada nivel
+    // expandidos a la vez. Se construye dos veces, como al refrescar la UI, para
+    // que el segundo listado dependa de lo que expulsó el primero
+    std::set<fs::path> expanded;
+    for (fs::path node = root;;) {
+        std::vector<fs::path> subdirs = child_dirs(node);
+        if (subdirs.empty()) break;
+        expanded.insert(subdirs.begin(), subdirs.end());
+        node = subdirs.front();
+    }
+    std::vector<EntryInfo> listing;
+    std::uintmax_t max_cache = 0;
+    for (int pass = 0; pass < 2 && ok; ++pass) {
+        std::vector<EntryInfo> refreshed;
+        build_tree_entries(root, expanded, refreshed, 0, 100);
+        max_cache = std::max(max_cache, get_cache_memory());
+        if (pass == 1 && !same_listing(listing, refreshed)) {
+            std::cerr << "El listado expandido cambia al refrescar" << std::endl;
+            ok = false;
+        }
+        listing = std::move(refreshed);
+    }
+    ok = ok && listing_consistent(listing);
+    auto t3 = std::chrono::steady_clock::now();
+    // Las filas del listado quedan fuera del presupuesto: aquí se comprueba la
+    // caché y el RSS solo se informa
+    std::cout << "Expansión múltiple: " << expanded.size() << " directorios expandidos, "
+              << listing.size() << " filas en " << std::chrono::duration<double>(t3 - t2).count()
+              << " s, caché " << human_readable_size(max_cache) << ", pico RSS +"
+              << human_readable_size((peak_rss_kb() - baseline_kb) * 1024ULL) << " con el listado" << std::endl;
+    if (cap != 0 && max_cache > cap) {
+        std::cerr << "La caché supera el límite con varios directorios expandidos" << std::endl;
+        ok = false;
+    }
+    // La ejecución sin límite va en un hijo: su memoria no afecta a la medida
+    if (ok && compare && cap != 0) {
+        bool same = run_in_child([&] {
+            set_memory_cap(0);
+            clear_dir_size_cache();
+            std::vector<EntryInfo> reference;
+            build_tree_entries(root, expanded, reference, 0, 100);
+            return same_listing(listing, reference);
+        });
+        std::cout << "Comparación sin límite: " << (same ? "iguales" : "distintos") << std::endl;
+        ok = same;
+    }
+    std::cout << (ok ? "OK" : "FALLO") << std::endl;
+    return ok ? 0 : 1;
+}